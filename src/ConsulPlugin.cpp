@@ -16,6 +16,11 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -27,18 +32,39 @@
 
 #include "ring_buffer/ring_buffer.h"
 
+#include "ControlMap.hpp"
+#include "MidiArena.hpp"
+#include "OscServer.hpp"
+
 START_NAMESPACE_DISTRHO
 
 class ConsulPlugin : public PluginEx
 {
 public:
     ConsulPlugin()
-        : PluginEx(0/*parameters*/, 0/*programs*/, 3/*states*/)
+        : PluginEx(0/*parameters*/, 0/*programs*/, 4/*states*/)
         , fMidiEvents(128 * sizeof(MidiEvent))
-    {}
+        , fMidiArena(64 * 1024)
+        , fControlEvents(128 * sizeof(ControlEvent))
+        , fControlTable(nullptr)
+        , fPendingControlTable(nullptr)
+        , fRetiredControlTable(nullptr)
+        , fMidiArenaPendingRelease(nullptr)
+    {
+#if CONSUL_OSC_UDP_PORT > 0
+        fOscServer.reset(new OscServer(CONSUL_OSC_UDP_PORT, std::bind(&ConsulPlugin::onOscControl,
+                            this, std::placeholders::_1, std::placeholders::_2)));
+#endif
+    }
 
     virtual ~ConsulPlugin()
-    {}
+    {
+        fOscServer.reset();
+
+        delete fControlTable;
+        delete fPendingControlTable.exchange(nullptr);
+        delete fRetiredControlTable.exchange(nullptr);
+    }
 
     const char* getLabel() const override
     {
@@ -79,7 +105,7 @@ public:
         case 0:
             state.key = "config";
             state.defaultValue = "{}";
-            state.hints = kStateIsOnlyForUI;
+            state.hints = 0; // MIDI map is also compiled by the DSP
             break;
         case 1:
             state.key = "ui";
@@ -91,6 +117,11 @@ public:
             state.defaultValue = "";
             state.hints = kStateIsBase64Blob | kStateIsOnlyForDSP;
             break;
+        case 3:
+            state.key = "control";
+            state.defaultValue = "";
+            state.hints = kStateIsBase64Blob | kStateIsOnlyForDSP;
+            break;
         default:
             PluginEx::initState(index, state);
             return;
@@ -109,12 +140,35 @@ public:
             return;
         }
 
+        // Raw MIDI stream, can contain multiple messages including SysEx
         if ((::strcmp(key, "midi") == 0) && (::strlen(value) > 0)) {
             std::vector<uint8_t> data = d_getChunkFromBase64String(value);
-            fMidiEvents.put(*reinterpret_cast<MidiEvent*>(data.data()));
+            putMidiBytes(data.data(), data.size());
             return;
         }
 
+        // Control value for MIDI generated by the DSP, ie. macros
+        if ((::strcmp(key, "control") == 0) && (::strlen(value) > 0)) {
+            std::vector<uint8_t> data = d_getChunkFromBase64String(value);
+
+            if (data.size() == sizeof(ControlMessage)) {
+                ControlMessage msg;
+                std::memcpy(&msg, data.data(), sizeof(msg));
+                msg.id[sizeof(msg.id) - 1] = '\0';
+                putControlValue(msg.id, msg.value);
+            }
+
+            return;
+        }
+
+        if (::strcmp(key, "config") == 0) {
+            std::lock_guard<std::mutex> lock(fControlMapMutex);
+
+            deleteRetiredControlTable();
+            // Pending table was never seen by run() if it is still there
+            delete fPendingControlTable.exchange(fControlMap.parseConfig(value));
+        }
+
         fState[key] = value;
     }
 
@@ -132,18 +186,195 @@ public:
     void run(const float** /*inputs*/, float** /*outputs*/, uint32_t /*frames*/,
              const MidiEvent* /*midiEvents*/, uint32_t /*midiEventCount*/) override
     {
+        // Long messages written during the previous call have been consumed
+        // by the host at this point, their storage can be reused.
+        if (fMidiArenaPendingRelease != nullptr) {
+            fMidiArena.release(fMidiArenaPendingRelease);
+            fMidiArenaPendingRelease = nullptr;
+        }
+
         MidiEvent event;
         
         while (fMidiEvents.get(event)) {
             writeMidiEvent(event);
+
+            if (event.size > MidiEvent::kDataSize) {
+                fMidiArenaPendingRelease = event.dataExt + event.size;
+            }
+        }
+
+        // Adopt the table compiled after the last config change. The previous
+        // one is retired and deleted later outside the audio thread, wait for
+        // the retired slot to be emptied if it is still occupied.
+        if (fPendingControlTable.load() != nullptr) {
+            ControlMap::Table* empty = nullptr;
+
+            if ((fControlTable == nullptr)
+                    || fRetiredControlTable.compare_exchange_strong(empty, fControlTable)) {
+                fControlTable = fPendingControlTable.exchange(nullptr);
+            }
+        }
+
+        ControlEvent controlEvent;
+
+        while (fControlEvents.get(controlEvent)) {
+            if ((fControlTable == nullptr) || (controlEvent.generation != fControlTable->generation)) {
+                continue; // resolved against an older or newer config, drop
+            }
+
+            const ControlMap::Slot& slot = fControlTable->slots[controlEvent.slot];
+            const uint8_t input = ControlMap::quantize(controlEvent.value);
+
+            for (uint32_t i = slot.first; i < slot.first + slot.count; i++) {
+                fControlTable->targets[i].toMidiEvent(input, event);
+                writeMidiEvent(event);
+            }
         }
     }
 
 private:
+    // Ring_Buffer is single producer so writers need to be serialized, the
+    // reader in run() stays lock-free.
+    void putMidiBytes(const uint8_t* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(fMidiEventsWriteMutex);
+
+        while (size > 0) {
+            const size_t len = getMidiMessageLength(data, size);
+
+            if (len == 0) {
+                d_stderr2("ConsulPlugin : invalid MIDI data");
+                return;
+            }
+
+            if (fMidiEvents.size_free() < sizeof(MidiEvent)) {
+                d_stderr2("ConsulPlugin : MIDI queue full, dropping events");
+                return;
+            }
+
+            MidiEvent event;
+            event.frame = 0;
+            event.size = static_cast<uint32_t>(len);
+
+            if (len <= MidiEvent::kDataSize) {
+                std::memset(event.data, 0, sizeof(event.data));
+                std::memcpy(event.data, data, len);
+                event.dataExt = nullptr;
+            } else {
+                if (len >= fMidiArena.getCapacity()) {
+                    d_stderr2("ConsulPlugin : MIDI message too long, dropping %u bytes", event.size);
+                    return;
+                }
+
+                uint8_t* ext = fMidiArena.allocate(len);
+
+                if (ext == nullptr) {
+                    d_stderr2("ConsulPlugin : MIDI arena full, dropping %u bytes", event.size);
+                    return;
+                }
+
+                std::memcpy(ext, data, len);
+                std::memset(event.data, 0, sizeof(event.data));
+                event.dataExt = ext;
+            }
+
+            fMidiEvents.put(event);
+
+            data += len;
+            size -= len;
+        }
+    }
+
+    // Running status is not supported, returns 0 for invalid or incomplete data
+    static size_t getMidiMessageLength(const uint8_t* data, size_t size)
+    {
+        const uint8_t status = data[0];
+        size_t len;
+
+        if ((status & 0x80) == 0) {
+            return 0;
+        }
+
+        if (status == 0xf0) {
+            const void* eox = std::memchr(data, 0xf7, size);
+            return eox == nullptr ? 0 : static_cast<const uint8_t*>(eox) - data + 1;
+        }
+
+        switch (status & 0xf0) {
+        case 0xc0:
+        case 0xd0:
+            len = 2;
+            break;
+        case 0xf0:
+            len = (status == 0xf1) || (status == 0xf3) ? 2 : (status == 0xf2) ? 3 : 1;
+            break;
+        default:
+            len = 3;
+            break;
+        }
+
+        return len <= size ? len : 0;
+    }
+
+    // Called from the UI and OscServer threads, MIDI is generated in run().
+    // Returns false if the id is not mapped to any MIDI.
+    bool putControlValue(const char* id, float value)
+    {
+        ControlEvent event;
+
+        // Allows run() to adopt a pending table before it sees this event
+        deleteRetiredControlTable();
+
+        {
+            std::lock_guard<std::mutex> lock(fControlMapMutex);
+
+            if (! fControlMap.makeEvent(id, value, event)) {
+                return false;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(fControlEventsWriteMutex);
+
+        if (fControlEvents.size_free() < sizeof(ControlEvent)) {
+            d_stderr2("ConsulPlugin : control queue full, dropping %s", id);
+            return true; // still a known control
+        }
+
+        fControlEvents.put(event);
+
+        return true;
+    }
+
+    // Retired table is no longer referenced by run()
+    void deleteRetiredControlTable()
+    {
+        delete fRetiredControlTable.exchange(nullptr);
+    }
+
+    bool onOscControl(const char* id, float value)
+    {
+        return putControlValue(id, value);
+    }
+
     typedef std::map<String,String> StateMap;
 
     StateMap    fState;
     Ring_Buffer fMidiEvents;
+    std::mutex  fMidiEventsWriteMutex;
+    MidiArena   fMidiArena;
+    ControlMap  fControlMap;
+    std::mutex  fControlMapMutex;
+    Ring_Buffer fControlEvents;
+    std::mutex  fControlEventsWriteMutex;
+
+    ControlMap::Table*              fControlTable; // owned by run()
+    std::atomic<ControlMap::Table*> fPendingControlTable;
+    std::atomic<ControlMap::Table*> fRetiredControlTable;
+
+    const uint8_t* fMidiArenaPendingRelease;
+
+    // Declared last so it is destroyed first, its thread uses members above
+    std::unique_ptr<OscServer> fOscServer;
 
 };
 
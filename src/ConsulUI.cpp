@@ -16,20 +16,60 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <string>
+#include <vector>
 
 #include "WebUI.hpp"
 
 #include "DistrhoPlugin.hpp"
 
+#include "ControlMap.hpp"
+#include "EventLog.hpp"
+
+// Budget in MIDI messages for each uiIdle() call during replay. The MIDI and
+// control queues of ConsulPlugin hold 128 events each and are only drained by
+// run(), which can be called less often than uiIdle() with large buffers, eg.
+// 4096 frames at 44.1 kHz is ~93 ms vs. ~16 ms idle interval.
+#define REPLAY_MAX_MESSAGES_PER_IDLE 16
+
 class ConsulUI : public WebUI
 {
 public:
     ConsulUI()
         : WebUI(800 /*width*/, 540 /*height*/, "#101010" /*background*/)
+        , fReplayStartTime(0)
+        , fReplaySpeed(1.0)
+        , fReplayDirect(false)
     {
         setFunctionHandler("control", 5, std::bind(&ConsulUI::onControl, this,
                             std::placeholders::_1, std::placeholders::_2));
+        setFunctionHandler("controlMidi", 3, std::bind(&ConsulUI::onControlMidi, this,
+                            std::placeholders::_1, std::placeholders::_2));
+        setFunctionHandler("controlMacro", 2, std::bind(&ConsulUI::onControlMacro, this,
+                            std::placeholders::_1, std::placeholders::_2));
+
+        // Session recording and replay, e.g. from the web inspector console:
+        //   DISTRHO.UI.sharedInstance.call('record', 'show')
+        //   DISTRHO.UI.sharedInstance.call('record', '')  // stop
+        //   DISTRHO.UI.sharedInstance.call('replay', 'show', 2.0, false)
+        // Sessions are referenced by name only and stored in a fixed directory,
+        // see eventLogSessionPath(). Any network client can make these calls.
+        setFunctionHandler("record", 1, std::bind(&ConsulUI::onRecord, this,
+                            std::placeholders::_1, std::placeholders::_2));
+        setFunctionHandler("replay", 3, std::bind(&ConsulUI::onReplay, this,
+                            std::placeholders::_1, std::placeholders::_2));
+    }
+
+    void uiIdle() override
+    {
+        WebUI::uiIdle();
+
+        if (fReplayLog.isOpen()) {
+            replayPendingEvents();
+        }
     }
 
     void stateChanged(const char* key, const char* value) override
@@ -44,40 +84,271 @@ public:
     void onControl(const Variant& args, uintptr_t origin) {
         size_t argc = args.getArraySize();
 
-        const Variant& id = args[0];
-        const Variant& value = args[1];
+        uint8_t midi[3];
+        midi[0] = static_cast<uint8_t>(args[2].getNumber());
+        midi[1] = static_cast<uint8_t>(args[3].getNumber());
+        midi[2] = argc > 4 ? static_cast<uint8_t>(args[4].getNumber()) : 0;
+
+        handleControl(args[0], args[1], midi, argc - 2, /*macro*/false, origin);
+    }
+
+    // Same as onControl() but MIDI is an array of bytes that can contain any
+    // number of messages including SysEx, see _handleControlInput() in ui.js
+    void onControlMidi(const Variant& args, uintptr_t origin) {
+        const Variant& bytes = args[2];
+        const size_t size = bytes.getArraySize();
+
+        if (fMidiBuffer.size() < size) {
+            fMidiBuffer.resize(size);
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            fMidiBuffer[i] = static_cast<uint8_t>(bytes[i].getNumber());
+        }
+
+        handleControl(args[0], args[1], fMidiBuffer.data(), size, /*macro*/false, origin);
+    }
+
+    // Macro controls, MIDI is generated by the DSP from the compiled map
+    void onControlMacro(const Variant& args, uintptr_t origin) {
+        sendControlValue(args[0], args[1]);
+        handleControl(args[0], args[1], nullptr, 0, /*macro*/true, origin);
+    }
+
+    void handleControl(const Variant& id, const Variant& value, const uint8_t* midi,
+                       size_t midiSize, bool macro, uintptr_t origin)
+    {
+        dispatchControl(id, value, midi, midiSize, macro, origin);
+        saveState();
+    }
+
+    // DPF UI provides sendNote() only, see also ConsulPlugin.cpp .
+    void sendMidi(const uint8_t* data, size_t size)
+    {
+        setState("midi", String::asBase64(data, size));
+    }
+
+    void sendControlValue(const Variant& id, const Variant& value)
+    {
+        ControlMessage msg;
+        std::memset(&msg, 0, sizeof(msg));
+        std::strncpy(msg.id, id.getString(), sizeof(msg.id) - 1);
+        msg.value = getFloatValue(value);
+
+        setState("control", String::asBase64(&msg, sizeof(msg)));
+    }
+
+    void onRecord(const Variant& args, uintptr_t /*origin*/)
+    {
+        const String name = args[0].getString();
+
+        if (fRecorder.isOpen()) {
+            fRecorder.close();
+            d_stderr("ConsulUI : recording stopped, %u events dropped", fRecorder.getDropCount());
+        }
+
+        if (name.isEmpty()) {
+            return;
+        }
+
+        const std::string path = eventLogSessionPath(name);
+
+        if (path.empty()) {
+            d_stderr2("ConsulUI : invalid session name %s", name.buffer());
+        } else if (fReplayLog.isOpen() && (path == fReplayPath)) {
+            // Recorder replaces the file on close, that fails on Windows while mapped
+            d_stderr2("ConsulUI : cannot record %s while it is replaying", name.buffer());
+        } else if (! fRecorder.open(path.c_str())) {
+            d_stderr2("ConsulUI : could not open %s for recording", path.c_str());
+        }
+    }
+
+    // Speed 1.0 replays at original speed, <= 0 replays as fast as possible.
+    // Direct mode sends MIDI only, skipping UI state and connected UIs sync.
+    void onReplay(const Variant& args, uintptr_t /*origin*/)
+    {
+        const String name = args[0].getString();
+
+        fReplayLog.close();
+
+        if (name.isEmpty()) {
+            return;
+        }
+
+        const std::string path = eventLogSessionPath(name);
+
+        if (path.empty()) {
+            d_stderr2("ConsulUI : invalid session name %s", name.buffer());
+            return;
+        }
+
+        if (! fReplayLog.open(path.c_str())) {
+            d_stderr2("ConsulUI : could not open %s for replay", path.c_str());
+            return;
+        }
+
+        fReplayPath = path;
+        fReplaySpeed = args[1].getNumber();
+        fReplayDirect = args[2].getBoolean();
+        fReplayStartTime = eventLogTimeNow();
 
-        sendMidiEvent(
-            /*status*/ static_cast<uint8_t>(args[2].getNumber()),
-            /* data1*/ static_cast<uint8_t>(args[3].getNumber()),
-            /* data2*/ argc > 4 ? static_cast<uint8_t>(args[4].getNumber()) : 0,
-            /*  size*/ argc - 2
-        );
+        replayPendingEvents();
+    }
+
+private:
+    static float getFloatValue(const Variant& value)
+    {
+        if (value.isBoolean()) {
+            return value.getBoolean() ? 1.f : 0.f;
+        }
+
+        return static_cast<float>(value.getNumber());
+    }
+
+    // Does everything handleControl() does except saving the UI state, so it
+    // can be saved once for a batch of controls.
+    void dispatchControl(const Variant& id, const Variant& value, const uint8_t* midi,
+                         size_t midiSize, bool macro, uintptr_t origin)
+    {
+        if (midiSize > 0) {
+            sendMidi(midi, midiSize);
+        }
+
+        if (fRecorder.isOpen()) {
+            recordControl(id, value, midi, midiSize, macro);
+        }
 
-        // Save UI state to plugin instance persistent storage
         fState.setObjectItem(id.getString(), value);
-        setState("ui", fState.toJSON());
 
         // Keep all connected UIs in sync
         callback("onControl", { id, value }, kDestinationAll, /*exclude*/origin);
     }
 
-    // DPF UI provides sendNote() only, see also ConsulPlugin.cpp .
-    void sendMidiEvent(uint8_t status, uint8_t data1, uint8_t data2, uint32_t size)
+    // Save UI state to plugin instance persistent storage
+    void saveState()
     {
-        MidiEvent event;
-        event.frame = 0;
-        event.size = size;
-        event.data[0] = status;
-        event.data[1] = data1;
-        event.data[2] = data2;
-        event.dataExt = nullptr;
-        
-        setState("midi", String::asBase64(&event, sizeof(MidiEvent)));
+        setState("ui", fState.toJSON());
     }
 
-private:
-    Variant fState;
+    void recordControl(const Variant& id, const Variant& value, const uint8_t* midi,
+                       size_t midiSize, bool macro)
+    {
+        EventRecord record;
+        std::memset(&record, 0, sizeof(record));
+
+        record.time = eventLogTimeNow() - fRecorder.getStartTime();
+        std::strncpy(record.id, id.getString(), sizeof(record.id) - 1);
+
+        record.value = getFloatValue(value);
+
+        if (value.isBoolean()) {
+            record.flags |= EventRecord::kFlagBoolean;
+        }
+
+        if (macro) {
+            record.flags |= EventRecord::kFlagMacro;
+        }
+
+        record.midiSize = static_cast<uint32_t>(midiSize);
+
+        if ((midiSize > 0) && (midiSize <= sizeof(record.midiData))) { // midi is null for macros
+            std::memcpy(record.midiData, midi, midiSize);
+        }
+
+        fRecorder.append(record, midi);
+    }
+
+    // Number of MidiEvents a byte stream expands to in the plugin, every
+    // status byte except EOX starts a message.
+    static size_t countMidiMessages(const uint8_t* data, size_t size)
+    {
+        size_t count = 0;
+
+        for (size_t i = 0; i < size; i++) {
+            if ((data[i] & 0x80) && (data[i] != 0xf7)) {
+                count++;
+            }
+        }
+
+        return count;
+    }
+
+    // Timing resolution is bounded by the uiIdle() rate. At most a fixed
+    // number of MIDI messages is sent per call, also when replaying at full
+    // speed. A single record larger than the budget is sent on its own.
+    void replayPendingEvents()
+    {
+        const uint64_t elapsed = fReplaySpeed > 0
+            ? static_cast<uint64_t>(fReplaySpeed * (eventLogTimeNow() - fReplayStartTime))
+            : UINT64_MAX;
+
+        size_t sent = 0;
+        bool replayed = false;
+
+        while (! fReplayLog.atEnd()) {
+            const EventRecord& record = fReplayLog.getRecord();
+
+            if (record.time > elapsed) {
+                break;
+            }
+
+            const uint8_t* midi = fReplayLog.getMidiData();
+
+            // Macros are queued as a single control event, records without
+            // MIDI also count so UI sync is bounded too.
+            const size_t count = countMidiMessages(midi, record.midiSize);
+            const size_t messages = (record.flags & EventRecord::kFlagMacro) || (count == 0) ? 1
+                                        : count;
+
+            if ((sent > 0) && (sent + messages > REPLAY_MAX_MESSAGES_PER_IDLE)) {
+                break;
+            }
+
+            char id[sizeof(record.id) + 1];
+            std::memcpy(id, record.id, sizeof(record.id));
+            id[sizeof(record.id)] = '\0';
+
+            const Variant value = (record.flags & EventRecord::kFlagBoolean)
+                ? Variant(record.value != 0)
+                : Variant(static_cast<double>(record.value));
+
+            const bool macro = (record.flags & EventRecord::kFlagMacro) != 0;
+
+            if (macro) {
+                sendControlValue(Variant(id), value);
+            }
+
+            if (fReplayDirect) {
+                if (record.midiSize > 0) {
+                    sendMidi(midi, record.midiSize);
+                }
+            } else {
+                dispatchControl(Variant(id), value, midi, record.midiSize, macro,
+                                /*exclude none*/0);
+            }
+
+            fReplayLog.next();
+            sent += messages;
+            replayed = true;
+        }
+
+        if (! fReplayDirect && replayed) {
+            saveState();
+        }
+
+        if (fReplayLog.atEnd()) {
+            fReplayLog.close();
+        }
+    }
+
+    Variant              fState;
+    std::vector<uint8_t> fMidiBuffer;
+    EventLogWriter       fRecorder;
+    EventLogReader       fReplayLog;
+    std::string          fReplayPath;
+    uint64_t             fReplayStartTime;
+    double               fReplaySpeed;
+    bool                 fReplayDirect;
 
 };
 
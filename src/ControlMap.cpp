@@ -0,0 +1,472 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ControlMap.hpp"
+
+namespace {
+
+// Minimal JSON reader, only what is needed for extracting the MIDI map from
+// the config object written by JSON.stringify() in ui.js .
+
+struct JsonReader
+{
+    const char* p;
+
+    void skipSpace()
+    {
+        while ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')) {
+            p++;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+
+        if (*p != c) {
+            return false;
+        }
+
+        p++;
+        return true;
+    }
+
+    bool readString(std::string& s)
+    {
+        if (! consume('"')) {
+            return false;
+        }
+
+        s.clear();
+
+        while ((*p != '"') && (*p != '\0')) {
+            if ((*p == '\\') && (p[1] != '\0')) {
+                p++;
+            }
+
+            s += *p++;
+        }
+
+        return consume('"');
+    }
+
+    bool readNumberOrNull(int& value, bool& isNull)
+    {
+        skipSpace();
+
+        if (::strncmp(p, "null", 4) == 0) {
+            p += 4;
+            isNull = true;
+            return true;
+        }
+
+        char* end;
+        const double d = ::strtod(p, &end);
+
+        if (end == p) {
+            return false;
+        }
+
+        p = end;
+        value = static_cast<int>(d);
+        isNull = false;
+
+        return true;
+    }
+
+    bool skipValue()
+    {
+        skipSpace();
+
+        if (*p == '"') {
+            std::string s;
+            return readString(s);
+        }
+
+        if ((*p == '{') || (*p == '[')) {
+            const char close = *p == '{' ? '}' : ']';
+            p++;
+
+            if (consume(close)) {
+                return true;
+            }
+
+            do {
+                if (close == '}') {
+                    std::string key;
+
+                    if (! readString(key) || ! consume(':')) {
+                        return false;
+                    }
+                }
+
+                if (! skipValue()) {
+                    return false;
+                }
+            } while (consume(','));
+
+            return consume(close);
+        }
+
+        // Number, true, false or null
+        const char* start = p;
+
+        while ((*p != ',') && (*p != '}') && (*p != ']') && (*p != '\0')) {
+            p++;
+        }
+
+        return p != start;
+    }
+};
+
+typedef DISTRHO::ControlMap::Target Target;
+typedef DISTRHO::ControlMap::Slot   Slot;
+typedef DISTRHO::ControlMap::Table  Table;
+
+void fillTarget(Target& target, int min, int max, const std::string& curve)
+{
+    for (int i = 0; i < 128; i++) {
+        const double x = i / 127.0;
+        double y;
+
+        if (curve == "exp") {
+            y = x * x;
+        } else if (curve == "log") {
+            y = std::sqrt(x);
+        } else if (curve == "s") {
+            y = x * x * (3.0 - 2.0 * x);
+        } else {
+            y = x; // linear
+        }
+
+        const long v = std::lround(min + (max - min) * y);
+        target.value[i] = static_cast<uint8_t>(v < 0 ? 0 : v > 127 ? 127 : v);
+    }
+}
+
+// [statusOn, statusOff, index]
+bool readSimpleEntry(JsonReader& r, Target& target)
+{
+    int vals[3] = { 0, 0, 0 };
+    bool isNull[3] = { true, true, true };
+    int n = 0;
+
+    do {
+        int v;
+        bool nul;
+
+        if (! r.readNumberOrNull(v, nul)) {
+            return false;
+        }
+
+        if (n < 3) {
+            vals[n] = v;
+            isNull[n] = nul;
+        }
+
+        n++;
+    } while (r.consume(','));
+
+    if (! r.consume(']') || (n < 3) || isNull[0] || isNull[2]) {
+        return false;
+    }
+
+    target.statusOn = static_cast<uint8_t>(vals[0]);
+    target.statusOff = isNull[1] ? 0 : static_cast<uint8_t>(vals[1]);
+    target.index = static_cast<uint8_t>(vals[2] & 0x7f);
+    fillTarget(target, 0, 127, "linear");
+
+    return true;
+}
+
+// { "ch": 1, "cc": 7, "min": 0, "max": 127, "curve": "linear" }
+bool readMacroTarget(JsonReader& r, Target& target)
+{
+    if (! r.consume('{')) {
+        return false;
+    }
+
+    int ch = 1, index = -1, min = 0, max = 127;
+    bool note = false;
+    std::string key, curve;
+
+    if (! r.consume('}')) {
+        do {
+            if (! r.readString(key) || ! r.consume(':')) {
+                return false;
+            }
+
+            int v;
+            bool nul;
+
+            if (key == "curve") {
+                if (! r.readString(curve)) {
+                    return false;
+                }
+            } else if ((key == "ch") || (key == "cc") || (key == "note") || (key == "min")
+                        || (key == "max")) {
+                if (! r.readNumberOrNull(v, nul) || nul) {
+                    return false;
+                }
+
+                if (key == "ch") {
+                    ch = v;
+                } else if (key == "min") {
+                    min = v;
+                } else if (key == "max") {
+                    max = v;
+                } else {
+                    index = v;
+                    note = key == "note";
+                }
+            } else if (! r.skipValue()) {
+                return false;
+            }
+        } while (r.consume(','));
+
+        if (! r.consume('}')) {
+            return false;
+        }
+    }
+
+    if ((index < 0) || (ch < 1) || (ch > 16)) {
+        return false;
+    }
+
+    const uint8_t channel = static_cast<uint8_t>(ch - 1);
+
+    target.statusOn = (note ? 0x90 : 0xb0) | channel;
+    target.statusOff = note ? (0x80 | channel) : 0;
+    target.index = static_cast<uint8_t>(index & 0x7f);
+    fillTarget(target, min, max, curve);
+
+    return true;
+}
+
+// { "macro": [target, ...] }, other keys are ignored
+bool readObjectEntry(JsonReader& r, std::vector<Target>& targets)
+{
+    if (r.consume('}')) {
+        return true;
+    }
+
+    std::string key;
+
+    do {
+        if (! r.readString(key) || ! r.consume(':')) {
+            return false;
+        }
+
+        if (key != "macro") {
+            if (! r.skipValue()) {
+                return false;
+            }
+
+            continue;
+        }
+
+        if (! r.consume('[')) {
+            return false;
+        }
+
+        if (r.consume(']')) {
+            continue;
+        }
+
+        do {
+            Target target;
+
+            if (! readMacroTarget(r, target)) {
+                return false;
+            }
+
+            targets.push_back(target);
+        } while (r.consume(','));
+
+        if (! r.consume(']')) {
+            return false;
+        }
+    } while (r.consume(','));
+
+    return r.consume('}');
+}
+
+// Same as ConsulUI._buildDefaultMidiMap() and controlDescriptor in ui.js, so
+// controls work before the web UI is opened for the first time.
+void fillDefaultMap(Table& table, std::unordered_map<std::string,uint32_t>& slotIds)
+{
+    static const struct {
+        char    id;
+        int     n;
+        bool    cont;
+        uint8_t base;
+        uint8_t ch;
+    } descriptors[] = {
+        { 'b', 16, false, 0   , 1 },
+        { 'k', 16, true , 0   , 1 },
+        { 'f', 8 , true , 0x10, 1 }
+    };
+
+    for (const auto& desc : descriptors) {
+        for (int i = 0; i < desc.n; i++) {
+            char id[16];
+            std::snprintf(id, sizeof(id), "%c-%02d", desc.id, i + 1);
+
+            Target target;
+            target.statusOn = (desc.cont ? 0xb0 : 0x90) | (desc.ch - 1);
+            target.statusOff = desc.cont ? 0 : (0x80 | (desc.ch - 1));
+            target.index = static_cast<uint8_t>((desc.base + i) & 0x7f);
+            fillTarget(target, 0, 127, "linear");
+
+            Slot slot;
+            slot.first = static_cast<uint32_t>(table.targets.size());
+            slot.count = 1;
+
+            table.targets.push_back(target);
+            slotIds[id] = static_cast<uint32_t>(table.slots.size());
+            table.slots.push_back(slot);
+        }
+    }
+}
+
+} // namespace
+
+START_NAMESPACE_DISTRHO
+
+ControlMap::ControlMap()
+    : fGeneration(0)
+{}
+
+ControlMap::Table* ControlMap::parseConfig(const char* json)
+{
+    Table* table = new Table;
+    table->generation = ++fGeneration;
+
+    fSlotIds.clear();
+
+    JsonReader r { json };
+
+    if (! r.consume('{')) {
+        return table;
+    }
+
+    if (r.consume('}')) {
+        fillDefaultMap(*table, fSlotIds);
+        return table;
+    }
+
+    const auto fail = [this, table]() {
+        fSlotIds.clear();
+        table->slots.clear();
+        table->targets.clear();
+        return table;
+    };
+
+    std::string key;
+    bool hasMap = false;
+
+    do {
+        if (! r.readString(key) || ! r.consume(':')) {
+            return fail();
+        }
+
+        if (key != "map") {
+            if (! r.skipValue()) {
+                return fail();
+            }
+
+            continue;
+        }
+
+        if (! r.consume('{')) {
+            return fail();
+        }
+
+        hasMap = true;
+
+        if (r.consume('}')) {
+            continue;
+        }
+
+        std::string id;
+
+        do {
+            if (! r.readString(id) || ! r.consume(':')) {
+                return fail();
+            }
+
+            Slot slot;
+            slot.first = static_cast<uint32_t>(table->targets.size());
+
+            if (r.consume('[')) {
+                Target target;
+
+                if (! readSimpleEntry(r, target)) {
+                    return fail();
+                }
+
+                table->targets.push_back(target);
+            } else if (r.consume('{')) {
+                if (! readObjectEntry(r, table->targets)) {
+                    return fail();
+                }
+            } else if (! r.skipValue()) {
+                return fail();
+            }
+
+            slot.count = static_cast<uint32_t>(table->targets.size()) - slot.first;
+
+            if (slot.count > 0) {
+                fSlotIds[id] = static_cast<uint32_t>(table->slots.size());
+                table->slots.push_back(slot);
+            }
+        } while (r.consume(','));
+
+        if (! r.consume('}')) {
+            return fail();
+        }
+    } while (r.consume(','));
+
+    if (! hasMap) {
+        fillDefaultMap(*table, fSlotIds);
+    }
+
+    return table;
+}
+
+bool ControlMap::makeEvent(const char* id, float value, ControlEvent& event) const
+{
+    const auto it = fSlotIds.find(id);
+
+    if (it == fSlotIds.end()) {
+        return false;
+    }
+
+    event.generation = fGeneration;
+    event.slot = it->second;
+    event.value = value;
+
+    return true;
+}
+
+END_NAMESPACE_DISTRHO
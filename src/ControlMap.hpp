@@ -0,0 +1,128 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROL_MAP_HPP
+#define CONTROL_MAP_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DistrhoPlugin.hpp"
+
+START_NAMESPACE_DISTRHO
+
+// Control value sent from the UI to the plugin as the "control" state, for
+// controls whose MIDI is generated natively, ie. macros.
+
+struct ControlMessage
+{
+    char  id[8]; // nul terminated
+    float value; // normalized [0-1.0], 0/1 for buttons
+};
+
+// Control value queued for the audio thread, already resolved to a slot of
+// the table with matching generation.
+
+struct ControlEvent
+{
+    uint32_t generation;
+    uint32_t slot;
+    float    value;
+};
+
+// Native copy of the control id to MIDI mapping stored in the "config" state
+// by the web UI, see ConsulUI._buildDefaultMidiMap() in ui.js . Every control
+// is compiled into a slot that expands to one or more MIDI messages, so the
+// audio thread only needs to index flat arrays.
+//
+// Supported map entries:
+//   "f-01": [statusOn, statusOff, index]
+//   "f-01": { "macro": [ { "ch": 1, "cc": 7, "min": 0, "max": 127, "curve": "linear" },
+//                        { "ch": 2, "note": 60, "curve": "exp" }, ... ] }
+//
+// "ch" defaults to 1, "min" to 0, "max" to 127 and "curve" to "linear". Other
+// curves are "exp", "log" and "s". Setting min > max inverts the range. Note
+// targets send note off when the resulting value is 0. Any other entries,
+// eg. raw MIDI, are skipped.
+
+class ControlMap
+{
+public:
+    struct Target
+    {
+        uint8_t statusOn;
+        uint8_t statusOff; // 0 if there is no off message (CC)
+        uint8_t index;
+        uint8_t value[128]; // output value for each 7-bit input value
+
+        void toMidiEvent(uint8_t input, MidiEvent& event) const
+        {
+            const uint8_t output = value[input & 0x7f];
+
+            event.frame = 0;
+            event.size = 3;
+            event.data[0] = ((statusOff != 0) && (output == 0)) ? statusOff : statusOn;
+            event.data[1] = index;
+            event.data[2] = output;
+            event.data[3] = 0;
+            event.dataExt = nullptr;
+        }
+    };
+
+    struct Slot
+    {
+        uint32_t first; // index into targets
+        uint32_t count;
+    };
+
+    // Immutable once compiled, safe to read from the audio thread
+    struct Table
+    {
+        uint32_t            generation;
+        std::vector<Slot>   slots;
+        std::vector<Target> targets;
+    };
+
+    ControlMap();
+
+    // Parses the "map" object of a config JSON string and returns a newly
+    // compiled table, caller takes ownership. The default map of the web UI
+    // is compiled if the config has no map, eg. "{}" for a new instance whose
+    // UI was never opened. The returned table is empty if the JSON is not
+    // valid.
+    Table* parseConfig(const char* json);
+
+    // Resolves a control id to a slot of the last compiled table
+    bool makeEvent(const char* id, float value, ControlEvent& event) const;
+
+    // Same as Math.floor(127 * v) in ui.js
+    static uint8_t quantize(float value)
+    {
+        return value <= 0 ? 0 : value >= 1.f ? 127 : static_cast<uint8_t>(127.f * value);
+    }
+
+private:
+    std::unordered_map<std::string,uint32_t> fSlotIds;
+    uint32_t fGeneration;
+
+};
+
+END_NAMESPACE_DISTRHO
+
+#endif // CONTROL_MAP_HPP
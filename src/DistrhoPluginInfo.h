@@ -25,6 +25,14 @@
  */
 #define DPF_WEBUI_LINUX_GTK_WEBVIEW_FAKE_VIEWPORT 1
 
+/**
+   Listen for OSC control messages on this UDP port, 0 disables.
+   @see OscServer.hpp
+ */
+#ifndef CONSUL_OSC_UDP_PORT
+# define CONSUL_OSC_UDP_PORT 0
+#endif
+
 /**
    The plugin name.@n
    This is used to identify your plugin before a Plugin instance can be created.
@@ -0,0 +1,544 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "DistrhoUtils.hpp"
+
+#include "EventLog.hpp"
+
+#define MAGIC              "CONSULEV"
+#define VERSION            2
+#define QUEUE_SIZE         (64 * 1024)  // bytes
+#define INITIAL_CAPACITY   (128 * 1024) // bytes
+#define FLUSH_INTERVAL_MS  10
+#define SESSION_DIR        "Consul/sessions"
+#define SESSION_EXT        ".log"
+#define SESSION_NAME_MAX   64
+#define TEMP_EXT           ".tmp"
+
+#ifdef _WIN32
+# define INVALID_FD reinterpret_cast<intptr_t>(INVALID_HANDLE_VALUE)
+# define PATH_SEPARATOR '\\'
+#else
+# define INVALID_FD -1
+# define PATH_SEPARATOR '/'
+#endif
+
+namespace {
+
+struct Header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;
+    uint64_t size;       // bytes after header
+};
+
+static_assert(sizeof(Header) == EventLogReader::kHeaderSize, "Unexpected Header size");
+
+intptr_t openFile(const char* path, bool write)
+{
+#ifdef _WIN32
+    HANDLE h = ::CreateFileA(path, write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                             FILE_SHARE_READ, nullptr, write ? CREATE_ALWAYS : OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    return reinterpret_cast<intptr_t>(h);
+#else
+    return ::open(path, write ? (O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW) : (O_RDONLY | O_NOFOLLOW),
+                  0644);
+#endif
+}
+
+void closeFile(intptr_t file)
+{
+#ifdef _WIN32
+    ::CloseHandle(reinterpret_cast<HANDLE>(file));
+#else
+    ::close(static_cast<int>(file));
+#endif
+}
+
+bool resizeFile(intptr_t file, size_t size)
+{
+#ifdef _WIN32
+    LARGE_INTEGER pos;
+    pos.QuadPart = static_cast<LONGLONG>(size);
+    return ::SetFilePointerEx(reinterpret_cast<HANDLE>(file), pos, nullptr, FILE_BEGIN)
+            && ::SetEndOfFile(reinterpret_cast<HANDLE>(file));
+#else
+    return ::ftruncate(static_cast<int>(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+bool renameFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+    return ::MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return ::rename(from, to) == 0;
+#endif
+}
+
+size_t getFileSize(intptr_t file)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    return ::GetFileSizeEx(reinterpret_cast<HANDLE>(file), &size) ? static_cast<size_t>(size.QuadPart) : 0;
+#else
+    struct stat st;
+    return ::fstat(static_cast<int>(file), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+#endif
+}
+
+// Returns the mapped address or nullptr, *mapping receives an OS handle that
+// must be passed back to unmapFile()
+uint8_t* mapFile(intptr_t file, size_t size, bool write, void** mapping)
+{
+#ifdef _WIN32
+    HANDLE h = ::CreateFileMappingA(reinterpret_cast<HANDLE>(file), nullptr,
+                                    write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    if (h == nullptr) {
+        return nullptr;
+    }
+
+    void* addr = ::MapViewOfFile(h, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+
+    if (addr == nullptr) {
+        ::CloseHandle(h);
+        return nullptr;
+    }
+
+    *mapping = h;
+
+    return static_cast<uint8_t*>(addr);
+#else
+    void* addr = ::mmap(nullptr, size, write ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+                        static_cast<int>(file), 0);
+    *mapping = nullptr;
+
+    return addr == MAP_FAILED ? nullptr : static_cast<uint8_t*>(addr);
+#endif
+}
+
+void unmapFile(const uint8_t* data, size_t size, void* mapping)
+{
+#ifdef _WIN32
+    (void)size;
+    ::UnmapViewOfFile(data);
+    ::CloseHandle(static_cast<HANDLE>(mapping));
+#else
+    (void)mapping;
+    ::munmap(const_cast<uint8_t*>(data), size);
+#endif
+}
+
+// Letters, digits, '-', '_' and '.' only, cannot start with a dot
+bool isValidSessionName(const char* name)
+{
+    const size_t len = std::strlen(name);
+
+    if ((len == 0) || (len > SESSION_NAME_MAX) || (name[0] == '.')
+            || (std::strstr(name, "..") != nullptr)) {
+        return false;
+    }
+
+    for (const char* p = name; *p != '\0'; p++) {
+        const char c = *p;
+
+        if (! (((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))
+                || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '_') || (c == '.'))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Per-user data directory, empty if it cannot be determined
+std::string getUserDataPath()
+{
+#ifdef _WIN32
+    const char* appData = std::getenv("APPDATA");
+    return appData != nullptr ? std::string(appData) : std::string();
+#else
+# ifndef __APPLE__
+    const char* xdgDataHome = std::getenv("XDG_DATA_HOME");
+
+    if ((xdgDataHome != nullptr) && (xdgDataHome[0] == '/')) {
+        return std::string(xdgDataHome);
+    }
+# endif
+    const char* home = std::getenv("HOME");
+
+    if ((home == nullptr) || (home[0] == '\0')) {
+        return std::string();
+    }
+# ifdef __APPLE__
+    return std::string(home) + "/Library/Application Support";
+# else
+    return std::string(home) + "/.local/share";
+# endif
+#endif
+}
+
+// Creates a directory and any missing parent directories. Errors are only
+// checked for the last one, parents like a drive root can fail to create.
+bool makeDirectories(const std::string& path)
+{
+    bool ok = false;
+
+    for (size_t i = 1; i <= path.size(); i++) {
+        if ((i < path.size()) && (path[i] != '/') && (path[i] != PATH_SEPARATOR)) {
+            continue;
+        }
+
+        const std::string dir = path.substr(0, i);
+#ifdef _WIN32
+        ok = ::CreateDirectoryA(dir.c_str(), nullptr) || (::GetLastError() == ERROR_ALREADY_EXISTS);
+#else
+        ok = (::mkdir(dir.c_str(), 0755) == 0) || (errno == EEXIST);
+#endif
+    }
+
+    return ok;
+}
+
+} // namespace
+
+std::string eventLogSessionPath(const char* name)
+{
+    if (! isValidSessionName(name)) {
+        return std::string();
+    }
+
+    const std::string base = getUserDataPath();
+
+    if (base.empty()) {
+        return std::string();
+    }
+
+    std::string dir = base + PATH_SEPARATOR + SESSION_DIR;
+#ifdef _WIN32
+    for (char& c : dir) {
+        if (c == '/') {
+            c = PATH_SEPARATOR;
+        }
+    }
+#endif
+    if (! makeDirectories(dir)) {
+        return std::string();
+    }
+
+    return dir + PATH_SEPARATOR + name + SESSION_EXT;
+}
+
+uint64_t eventLogTimeNow()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+
+EventLogWriter::EventLogWriter()
+    : fQueue(QUEUE_SIZE)
+    , fRunning(false)
+    , fDropCount(0)
+    , fStartTime(0)
+    , fFile(INVALID_FD)
+    , fMapping(nullptr)
+    , fData(nullptr)
+    , fCapacity(0)
+    , fSize(0)
+    , fCount(0)
+{}
+
+EventLogWriter::~EventLogWriter()
+{
+    close();
+}
+
+bool EventLogWriter::open(const char* path)
+{
+    close();
+
+    // Recording goes to a temporary file that replaces path on close(), so
+    // a reader that has path mapped keeps reading the previous file.
+    fPath = path;
+    fFile = openFile((fPath + TEMP_EXT).c_str(), true);
+
+    if (fFile == INVALID_FD) {
+        fPath.clear();
+        return false;
+    }
+
+    fSize = 0;
+    fCount = 0;
+    fDropCount = 0;
+
+    if (! remap(INITIAL_CAPACITY)) {
+        close();
+        return false;
+    }
+
+    Header* header = reinterpret_cast<Header*>(fData);
+    std::memcpy(header->magic, MAGIC, sizeof(header->magic));
+    header->version = VERSION;
+    header->recordSize = sizeof(EventRecord);
+    header->count = 0;
+    header->size = 0;
+
+    fStartTime = eventLogTimeNow();
+    fRunning = true;
+    fThread = std::thread(&EventLogWriter::run, this);
+
+    return true;
+}
+
+void EventLogWriter::close()
+{
+    fRunning = false;
+
+    if (fThread.joinable()) {
+        fThread.join(); // flushes pending records before exiting
+    }
+
+    if (fData != nullptr) {
+        unmapFile(fData, EventLogReader::kHeaderSize + fCapacity, fMapping);
+        fData = nullptr;
+        fMapping = nullptr;
+    }
+
+    if (fFile != INVALID_FD) {
+        resizeFile(fFile, EventLogReader::kHeaderSize + fSize);
+        closeFile(fFile);
+        fFile = INVALID_FD;
+
+        const std::string tempPath = fPath + TEMP_EXT;
+
+        if (! renameFile(tempPath.c_str(), fPath.c_str())) {
+            d_stderr2("EventLogWriter : could not rename %s", tempPath.c_str());
+        }
+    }
+
+    fPath.clear();
+    fCapacity = 0;
+}
+
+void EventLogWriter::append(const EventRecord& record, const uint8_t* midi)
+{
+    const size_t extraSize = record.midiSize > sizeof(record.midiData) ? record.midiSize : 0;
+
+    // Record and MIDI must be queued together, reader checks for both
+    if (! fRunning || (fQueue.size_free() < sizeof(EventRecord) + extraSize)) {
+        fDropCount++;
+        return;
+    }
+
+    fQueue.put(record);
+
+    if (extraSize > 0) {
+        fQueue.put(midi, extraSize);
+    }
+}
+
+void EventLogWriter::run()
+{
+    while (fRunning) {
+        if (! flush()) {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+    }
+
+    flush();
+}
+
+bool EventLogWriter::flush()
+{
+    if (fData == nullptr) {
+        return false;
+    }
+
+    EventRecord record;
+
+    while (fQueue.peek(record)) {
+        const size_t midiSize = record.midiSize > sizeof(record.midiData) ? record.midiSize : 0;
+
+        if (fQueue.size_used() < sizeof(EventRecord) + midiSize) {
+            break; // MIDI not queued yet
+        }
+
+        const size_t size = sizeof(EventRecord) + record.getExtraSize();
+        size_t capacity = fCapacity;
+
+        while (fSize + size > capacity) {
+            capacity *= 2;
+        }
+
+        if ((capacity != fCapacity) && ! remap(capacity)) {
+            d_stderr2("EventLogWriter : could not grow log file");
+            fDropCount++;
+            return false;
+        }
+
+        uint8_t* p = fData + EventLogReader::kHeaderSize + fSize;
+
+        fQueue.get(record);
+        std::memcpy(p, &record, sizeof(EventRecord));
+
+        if (midiSize > 0) {
+            fQueue.get(p + sizeof(EventRecord), midiSize);
+            std::memset(p + sizeof(EventRecord) + midiSize, 0, size - sizeof(EventRecord) - midiSize);
+        }
+
+        fSize += size;
+        fCount++;
+    }
+
+    Header* header = reinterpret_cast<Header*>(fData);
+    header->count = fCount;
+    header->size = fSize;
+
+    return true;
+}
+
+bool EventLogWriter::remap(size_t capacity)
+{
+    if (fData != nullptr) {
+        unmapFile(fData, EventLogReader::kHeaderSize + fCapacity, fMapping);
+        fData = nullptr;
+        fMapping = nullptr;
+    }
+
+    const size_t size = EventLogReader::kHeaderSize + capacity;
+
+    if (! resizeFile(fFile, size)) {
+        return false;
+    }
+
+    fData = mapFile(fFile, size, true, &fMapping);
+
+    if (fData == nullptr) {
+        return false;
+    }
+
+    fCapacity = capacity;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+EventLogReader::EventLogReader()
+    : fFile(INVALID_FD)
+    , fMapping(nullptr)
+    , fData(nullptr)
+    , fSize(0)
+    , fOffset(0)
+    , fEnd(0)
+{}
+
+EventLogReader::~EventLogReader()
+{
+    close();
+}
+
+bool EventLogReader::open(const char* path)
+{
+    close();
+
+    fFile = openFile(path, false);
+
+    if (fFile == INVALID_FD) {
+        return false;
+    }
+
+    fSize = getFileSize(fFile);
+
+    if (fSize < kHeaderSize) {
+        close();
+        return false;
+    }
+
+    fData = mapFile(fFile, fSize, false, &fMapping);
+
+    if (fData == nullptr) {
+        close();
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(fData);
+
+    if ((std::memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0)
+            || (header->version != VERSION) || (header->recordSize != sizeof(EventRecord))) {
+        close();
+        return false;
+    }
+
+    // Tolerate logs that were not closed properly
+    const size_t available = fSize - kHeaderSize;
+    fOffset = kHeaderSize;
+    fEnd = kHeaderSize + (header->size < available ? header->size : available);
+
+    return true;
+}
+
+bool EventLogReader::atEnd() const
+{
+    if ((fData == nullptr) || (fEnd - fOffset < sizeof(EventRecord))) {
+        return true;
+    }
+
+    // Also ends at a record whose MIDI was not completely written
+    return fEnd - fOffset - sizeof(EventRecord) < getRecord().getExtraSize();
+}
+
+void EventLogReader::close()
+{
+    if (fData != nullptr) {
+        unmapFile(fData, fSize, fMapping);
+        fData = nullptr;
+        fMapping = nullptr;
+    }
+
+    if (fFile != INVALID_FD) {
+        closeFile(fFile);
+        fFile = INVALID_FD;
+    }
+
+    fSize = 0;
+    fOffset = 0;
+    fEnd = 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENT_LOG_HPP
+#define EVENT_LOG_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "ring_buffer/ring_buffer.h"
+
+// Compact binary log of control events for recording a session and replaying
+// it later. The file is a fixed size header followed by fixed size records,
+// all in host byte order. MIDI that does not fit in a record, eg. SysEx, is
+// stored right after it and padded to a multiple of 8 bytes.
+
+struct EventRecord
+{
+    enum Flags : uint32_t
+    {
+        kFlagBoolean = 1 << 0, // value came from a button
+        kFlagMacro   = 1 << 1  // MIDI is generated by the DSP
+    };
+
+    uint64_t time;         // microseconds since start of recording
+    char     id[8];        // control id, nul terminated
+    float    value;
+    uint32_t flags;
+    uint32_t midiSize;
+    uint8_t  midiData[4];  // MIDI if midiSize <= 4, otherwise unused
+
+    // Size of the MIDI stored after the record, including padding
+    size_t getExtraSize() const
+    {
+        return midiSize > sizeof(midiData) ? (midiSize + 7) & ~static_cast<size_t>(7) : 0;
+    }
+};
+
+static_assert(sizeof(EventRecord) == 32, "Unexpected EventRecord size");
+
+// Appending is lock-free and never touches the file. Records are queued and
+// written to the memory mapped file by a background thread, if the queue is
+// full the record is dropped and counted. The log is written to a temporary
+// file that replaces the file at path when closed.
+
+class EventLogWriter
+{
+public:
+    EventLogWriter();
+    ~EventLogWriter();
+
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const
+    {
+        return fRunning;
+    }
+
+    // Single producer only. midi points to record.midiSize bytes, only read
+    // if they do not fit in record.midiData.
+    void append(const EventRecord& record, const uint8_t* midi);
+
+    uint64_t getStartTime() const
+    {
+        return fStartTime;
+    }
+
+    uint32_t getDropCount() const
+    {
+        return fDropCount;
+    }
+
+private:
+    void run();
+    bool flush();
+    bool remap(size_t capacity);
+
+    Ring_Buffer           fQueue;
+    std::atomic<bool>     fRunning;
+    std::atomic<uint32_t> fDropCount;
+    std::thread           fThread;
+    std::string           fPath;
+    uint64_t              fStartTime;
+    intptr_t              fFile;
+    void*                 fMapping;
+    uint8_t*              fData;
+    size_t                fCapacity; // bytes after header
+    size_t                fSize;     // bytes after header
+    uint64_t              fCount;
+
+};
+
+class EventLogReader
+{
+public:
+    EventLogReader();
+    ~EventLogReader();
+
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const
+    {
+        return fData != nullptr;
+    }
+
+    // Records are read sequentially, getRecord() and getMidiData() refer to
+    // the current record and are only valid if atEnd() returns false.
+    bool atEnd() const;
+
+    const EventRecord& getRecord() const
+    {
+        return *reinterpret_cast<const EventRecord*>(fData + fOffset);
+    }
+
+    const uint8_t* getMidiData() const
+    {
+        const EventRecord& record = getRecord();
+        return record.getExtraSize() > 0 ? fData + fOffset + sizeof(EventRecord)
+                                         : record.midiData;
+    }
+
+    void next()
+    {
+        fOffset += sizeof(EventRecord) + getRecord().getExtraSize();
+    }
+
+    static constexpr size_t kHeaderSize = 32;
+
+private:
+    intptr_t       fFile;
+    void*          fMapping;
+    const uint8_t* fData;
+    size_t         fSize;
+    size_t         fOffset;
+    size_t         fEnd;
+
+};
+
+// Returns the log file path for a session name, inside a directory owned by
+// the plugin under the per-user data directory which is created if needed.
+// Names are plain file names without extension, returns an empty string if
+// the name is not valid or the directory cannot be created.
+std::string eventLogSessionPath(const char* name);
+
+// Monotonic clock in microseconds
+uint64_t eventLogTimeNow();
+
+#endif // EVENT_LOG_HPP
@@ -0,0 +1,98 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDI_ARENA_HPP
+#define MIDI_ARENA_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Preallocated storage for MIDI messages that do not fit in MidiEvent::data,
+// referenced by MidiEvent::dataExt. Blocks are allocated by a single producer
+// and released by a single consumer (the audio thread) in the same order, so
+// the arena works as a ring of contiguous blocks and releasing a block also
+// releases any block allocated before it.
+
+class MidiArena
+{
+public:
+    explicit MidiArena(size_t capacity)
+        : fCapacity(capacity)
+        , fData(new uint8_t[capacity])
+        , fWritePos(0)
+        , fReadPos(0)
+    {}
+
+    // Producer. Returns nullptr if there is not enough contiguous space, a
+    // block always fits if all previous blocks were released and size is
+    // less than capacity.
+    uint8_t* allocate(size_t size)
+    {
+        size_t r = fReadPos.load(std::memory_order_acquire);
+        size_t w = fWritePos;
+        size_t offset;
+
+        // Write position never catches up with read position, w == r is empty.
+        // The consumer holds no blocks then and does not touch the read
+        // position until it gets the next one, so both can restart at 0.
+        if (w == r) {
+            fReadPos.store(0, std::memory_order_relaxed);
+            r = w = 0;
+        }
+
+        if (w >= r) {
+            if (w + size < fCapacity) {
+                offset = w;
+            } else if (size < r) {
+                offset = 0; // skip tail, it is reclaimed with this block
+            } else {
+                return nullptr;
+            }
+        } else if (w + size < r) {
+            offset = w;
+        } else {
+            return nullptr;
+        }
+
+        fWritePos = offset + size;
+
+        return fData.get() + offset;
+    }
+
+    size_t getCapacity() const
+    {
+        return fCapacity;
+    }
+
+    // Consumer. Releases the block ending at end and all previous blocks.
+    void release(const uint8_t* end)
+    {
+        fReadPos.store(static_cast<size_t>(end - fData.get()), std::memory_order_release);
+    }
+
+private:
+    const size_t               fCapacity;
+    std::unique_ptr<uint8_t[]> fData;
+    size_t                     fWritePos;
+    std::atomic<size_t>        fReadPos;
+
+};
+
+#endif // MIDI_ARENA_HPP
@@ -0,0 +1,275 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#ifdef _WIN32
+# include <winsock2.h>
+# include <ws2tcpip.h>
+#else
+# include <arpa/inet.h>
+# include <netinet/in.h>
+# include <sys/select.h>
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
+#include "OscServer.hpp"
+
+#define ADDRESS_PREFIX    "/control/"
+#define MAX_PACKET_SIZE   1536
+#define MAX_BUNDLE_DEPTH  4
+#define SEQ_RESET_WINDOW  1024 // larger backwards jumps mean sender restarted
+
+#ifdef _WIN32
+# define INVALID_FD static_cast<intptr_t>(INVALID_SOCKET)
+# define closesocket_ ::closesocket
+#else
+# define INVALID_FD -1
+# define closesocket_ ::close
+#endif
+
+namespace {
+
+int32_t readInt32(const uint8_t* p)
+{
+    return static_cast<int32_t>((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16)
+                                    | (uint32_t(p[2]) << 8) | uint32_t(p[3]));
+}
+
+float readFloat32(const uint8_t* p)
+{
+    const int32_t i = readInt32(p);
+    float f;
+    std::memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+// Returns the padded length of the OSC string at p or 0 if not terminated
+size_t oscStringSize(const uint8_t* p, size_t size)
+{
+    const void* nul = std::memchr(p, '\0', size);
+
+    if (nul == nullptr) {
+        return 0;
+    }
+
+    const size_t len = static_cast<const uint8_t*>(nul) - p;
+    const size_t padded = (len + 4) & ~static_cast<size_t>(3);
+
+    return padded <= size ? padded : 0;
+}
+
+} // namespace
+
+START_NAMESPACE_DISTRHO
+
+OscServer::OscServer(int port, ControlHandler handler)
+    : fHandler(handler)
+    , fRunning(false)
+    , fSocket(INVALID_FD)
+{
+#ifdef _WIN32
+    WSADATA wsa;
+
+    if (::WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        d_stderr2("OscServer : WSAStartup() failed");
+        return;
+    }
+#endif
+
+    fSocket = static_cast<intptr_t>(::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+
+    if (fSocket == INVALID_FD) {
+        d_stderr2("OscServer : could not create socket");
+        return;
+    }
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+
+    if (::bind(fSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        // Likely another plugin instance already listening on the same port
+        d_stderr2("OscServer : could not bind to UDP port %d", port);
+        closesocket_(fSocket);
+        fSocket = INVALID_FD;
+        return;
+    }
+
+    fRunning = true;
+    fThread = std::thread(&OscServer::run, this);
+}
+
+OscServer::~OscServer()
+{
+    fRunning = false;
+
+    if (fThread.joinable()) {
+        fThread.join();
+    }
+
+    if (fSocket != INVALID_FD) {
+        closesocket_(fSocket);
+    }
+
+#ifdef _WIN32
+    ::WSACleanup();
+#endif
+}
+
+void OscServer::run()
+{
+    uint8_t buf[MAX_PACKET_SIZE];
+
+    while (fRunning) {
+        // Wake up periodically to check for termination
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fSocket, &fds);
+
+        timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+
+        const int rc = ::select(static_cast<int>(fSocket + 1), &fds, nullptr, nullptr, &tv);
+
+        if (rc <= 0) {
+            continue;
+        }
+
+        const auto len = ::recv(fSocket, reinterpret_cast<char*>(buf), sizeof(buf), 0);
+
+        if (len > 0) {
+            handlePacket(buf, static_cast<size_t>(len));
+        }
+    }
+}
+
+void OscServer::handlePacket(const uint8_t* data, size_t size, int depth)
+{
+    if ((size < 4) || ((size & 3) != 0)) {
+        return;
+    }
+
+    if (data[0] == '/') {
+        handleMessage(data, size);
+        return;
+    }
+
+    // #bundle + 8 byte time tag + [size, element]...
+    if ((size < 16) || (std::memcmp(data, "#bundle", 8) != 0) || (depth == MAX_BUNDLE_DEPTH)) {
+        return;
+    }
+
+    size_t offset = 16;
+
+    while (offset + 4 <= size) {
+        const int32_t elemSize = readInt32(data + offset);
+        offset += 4;
+
+        if ((elemSize <= 0) || (offset + static_cast<size_t>(elemSize) > size)) {
+            return;
+        }
+
+        handlePacket(data + offset, static_cast<size_t>(elemSize), depth + 1);
+        offset += static_cast<size_t>(elemSize);
+    }
+}
+
+void OscServer::handleMessage(const uint8_t* data, size_t size)
+{
+    const size_t addrSize = oscStringSize(data, size);
+
+    if (addrSize == 0) {
+        return;
+    }
+
+    const char* address = reinterpret_cast<const char*>(data);
+    const size_t prefixLen = ::strlen(ADDRESS_PREFIX);
+
+    if ((::strncmp(address, ADDRESS_PREFIX, prefixLen) != 0) || (address[prefixLen] == '\0')) {
+        return;
+    }
+
+    const char* id = address + prefixLen;
+
+    const uint8_t* tags = data + addrSize;
+    const size_t tagsSize = oscStringSize(tags, size - addrSize);
+
+    if ((tagsSize == 0) || (tags[0] != ',')) {
+        return;
+    }
+
+    const uint8_t* args = tags + tagsSize;
+    const uint8_t* end = data + size;
+
+    float value;
+
+    switch (tags[1]) {
+    case 'f':
+        if (args + 4 > end) return;
+        value = readFloat32(args);
+        args += 4;
+        break;
+    case 'i':
+        if (args + 4 > end) return;
+        value = static_cast<float>(readInt32(args));
+        args += 4;
+        break;
+    case 'T':
+        value = 1.f;
+        break;
+    case 'F':
+        value = 0.f;
+        break;
+    default:
+        return;
+    }
+
+    const bool hasSeq = (tags[2] == 'i') && (args + 4 <= end);
+    const int32_t seq = hasSeq ? readInt32(args) : 0;
+
+    if (hasSeq && isStale(id, seq)) {
+        return;
+    }
+
+    // Unknown ids are not tracked, otherwise any sender could grow the map
+    if (fHandler(id, value) && hasSeq) {
+        fLastSeq[id] = seq;
+    }
+}
+
+bool OscServer::isStale(const char* id, int32_t seq) const
+{
+    const auto it = fLastSeq.find(id);
+
+    if (it == fLastSeq.end()) {
+        return false;
+    }
+
+    // Wrap-around safe comparison
+    const int32_t delta = static_cast<int32_t>(static_cast<uint32_t>(seq)
+                                                - static_cast<uint32_t>(it->second));
+
+    return (delta <= 0) && (delta > -SEQ_RESET_WINDOW);
+}
+
+END_NAMESPACE_DISTRHO
@@ -0,0 +1,77 @@
+/*
+ * Consul - Control Surface Library
+ * Copyright (C) 2022 Luciano Iam <oss@lucianoiam.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OSC_SERVER_HPP
+#define OSC_SERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "DistrhoPlugin.hpp"
+
+START_NAMESPACE_DISTRHO
+
+// Receives OSC messages over UDP on a dedicated thread. Intended for remote
+// controller apps that prefer low latency over guaranteed delivery, so there
+// is no head-of-line blocking like with the WebSocket connection.
+//
+// Accepted messages:
+//   /control/<id> ,f   value
+//   /control/<id> ,fi  value sequence
+//
+// Value can also be sent as i, T or F. When a sequence number is present,
+// messages older than the last one seen for the same control are dropped.
+// Sequence numbers are only tracked for ids accepted by the handler.
+// Bundles are unpacked and their elements handled in order.
+
+class OscServer
+{
+public:
+    // Returns false if the id does not resolve to a control
+    typedef std::function<bool(const char* id, float value)> ControlHandler;
+
+    OscServer(int port, ControlHandler handler);
+    ~OscServer();
+
+    bool isRunning() const
+    {
+        return fRunning;
+    }
+
+private:
+    void run();
+    void handlePacket(const uint8_t* data, size_t size, int depth = 0);
+    void handleMessage(const uint8_t* data, size_t size);
+    bool isStale(const char* id, int32_t seq) const;
+
+    ControlHandler    fHandler;
+    std::atomic<bool> fRunning;
+    std::thread       fThread;
+    intptr_t          fSocket;
+
+    std::unordered_map<std::string,int32_t> fLastSeq;
+
+};
+
+END_NAMESPACE_DISTRHO
+
+#endif // OSC_SERVER_HPP
@@ -228,9 +228,24 @@ export class MidiDialog extends Dialog {
                 const entry = entryTmpl.cloneNode(true),
                       id = desc.id + '-' + (i + 1).toString().padStart(2, '0'),
                       map = this._map[id];
+
+                entry.querySelector('.midi-map-target').innerText = `${desc.name} ${i + 1}`;
+
+                if (! Array.isArray(map)) {
+                    // Macro and raw MIDI entries are shown read-only, they are
+                    // set with ConsulUI.setMidiMapEntry(), see README.md
+                    entry.querySelectorAll('select').forEach(sel => sel.remove());
+
+                    const summary = document.createElement('div');
+                    summary.className = 'midi-map-summary';
+                    summary.innerText = MidiDialog._describeEntry(map);
+                    entry.appendChild(summary);
+
+                    mapElem.appendChild(entry);
+                    continue;
+                }
                 
                 entry.setAttribute('data-id', id);
-                entry.querySelector('.midi-map-target').innerText = `${desc.name} ${i + 1}`;
 
                 const status = entry.querySelector('.midi-map-status');
                 status.value = (map[0] ^ 0x90) == 0 ? 'note' : 'cc';
@@ -261,7 +276,7 @@ export class MidiDialog extends Dialog {
             const id = entry.getAttribute('data-id');
 
             if (!id) {
-                continue; // skip template
+                continue; // skip template and read-only entries
             }
 
             const statusType = entry.querySelector('.midi-map-status').value,
@@ -276,6 +291,22 @@ export class MidiDialog extends Dialog {
         this._callback(this._map);
     }
 
+    static _describeEntry(map) {
+        if (map && Array.isArray(map.macro)) {
+            return 'Macro ' + map.macro.map(t => {
+                const target = 'note' in t ? `Note ${t.note}` : `CC ${t.cc}`;
+                return `Ch ${t.ch || 1} ${target}`;
+            }).join(', ');
+        }
+
+        if (map && Array.isArray(map.midi)) {
+            return 'MIDI ' + map.midi.map(b => b === 'v' ? 'v'
+                : b.toString(16).toUpperCase().padStart(2, '0')).join(' ');
+        }
+
+        return 'None';
+    }
+
 }
 
 
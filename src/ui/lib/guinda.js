@@ -103,6 +103,12 @@ class Widget extends HTMLElement {
         this._root = this.attachShadow({mode: 'open'});
     }
 
+    disconnectedCallback() {
+        if (this._canvas) {
+            CanvasRenderer.detach(this);
+        }
+    }
+
     /**
      *  Internal
      */
@@ -193,7 +199,9 @@ class StatefulWidget extends Widget {
             return;
         }
 
-        this._redraw();
+        // Coalesce redraws, value can be updated many times per frame when
+        // applying a full UI state or receiving a burst of remote changes.
+        RedrawScheduler.schedule(this);
     }
 
 }
@@ -519,6 +527,133 @@ class ValueParser {
 }
 
 
+// Batches widget redraws so there is at most a single layout/paint pass per
+// animation frame regardless of how many widgets changed value.
+
+class RedrawScheduler {
+
+    static schedule(widget) {
+        if (! this._dirty) {
+            this._dirty = new Set();
+            this._frameRequested = false;
+        }
+
+        this._dirty.add(widget);
+
+        if (! this._frameRequested) {
+            this._frameRequested = true;
+            window.requestAnimationFrame(() => this.flush());
+        }
+    }
+
+    static flush() {
+        this._frameRequested = false;
+
+        if (! this._dirty) {
+            return;
+        }
+
+        const widgets = this._dirty;
+        this._dirty = new Set();
+
+        for (const widget of widgets) {
+            if (widget.isConnected) {
+                widget._redraw();
+            }
+        }
+    }
+
+}
+
+
+// Optional lightweight rendering for widgets that are drawn many times per
+// second. A single <canvas> avoids SVG attribute updates and style recalcs.
+
+class CanvasRenderer {
+
+    static isEnabled(widget) {
+        return widget._style('--renderer', 'svg').toLowerCase() == 'canvas';
+    }
+
+    static attach(widget) {
+        const canvas = document.createElement('canvas');
+        canvas.style.display = 'block';
+        canvas.style.width = '100%';
+        canvas.style.height = '100%';
+
+        widget._root.appendChild(canvas);
+        widget._canvas = canvas;
+        widget._ctx = canvas.getContext('2d');
+
+        // A single observer or window listener is shared by all widgets so
+        // nothing is left behind when widgets are removed, see detach().
+
+        if (! this._widgets) {
+            this._widgets = new Map(); // canvas -> widget
+
+            if (typeof(ResizeObserver) !== 'undefined') {
+                this._observer = new ResizeObserver((entries) => {
+                    for (const entry of entries) {
+                        const w = this._widgets.get(entry.target);
+
+                        if (w) {
+                            this._resize(w);
+                        }
+                    }
+                });
+            } else {
+                window.addEventListener('resize', () => {
+                    for (const w of this._widgets.values()) {
+                        this._resize(w);
+                    }
+                });
+            }
+        }
+
+        this._widgets.set(canvas, widget);
+
+        if (this._observer) {
+            this._observer.observe(canvas);
+        }
+
+        this._resize(widget);
+    }
+
+    static detach(widget) {
+        if (this._widgets) {
+            this._widgets.delete(widget._canvas);
+        }
+
+        if (this._observer) {
+            this._observer.unobserve(widget._canvas);
+        }
+    }
+
+    static _resize(widget) {
+        const canvas = widget._canvas,
+              k = window.devicePixelRatio || 1;
+        canvas.width = Math.round(k * canvas.clientWidth);
+        canvas.height = Math.round(k * canvas.clientHeight);
+        widget._redraw();
+    }
+
+    static clear(widget) {
+        const ctx = widget._ctx;
+        ctx.setTransform(1, 0, 0, 1, 0, 0);
+        ctx.clearRect(0, 0, widget._canvas.width, widget._canvas.height);
+        return ctx;
+    }
+
+    static arc(ctx, x, y, radius, startAngle, endAngle) {
+        // Angles in degrees, 0 pointing up like in SvgMath
+        const toRad = (a) => (a - 90) * Math.PI / 180.0;
+        ctx.beginPath();
+        ctx.arc(x, y, radius, toRad(startAngle), toRad(endAngle));
+    }
+
+}
+
+
 class SvgMath {
 
     // http://jsbin.com/quhujowota
@@ -594,6 +729,21 @@ class Knob extends RangeInputWidget {
     connectedCallback() {
         super.connectedCallback();
 
+        this.style.display = 'block';
+
+        if (CanvasRenderer.isEnabled(this)) {
+            this._colors = {
+                body       : this._style('--body-color', '#404040'),
+                range      : this._style('--range-color', '#404040'),
+                value      : this._style('--value-color', '#ffffff'),
+                pointerOff : this._style('--pointer-off-color', '#000')
+            };
+            this._colors.pointerOn = this._style('--pointer-on-color', this._colors.value);
+
+            CanvasRenderer.attach(this);
+            return;
+        }
+
         this._root.innerHTML = `<style>
             #body { fill: ${this._style('--body-color', '#404040')}; }
             #range { stroke: ${this._style('--range-color', '#404040')}; }
@@ -603,7 +753,6 @@ class Knob extends RangeInputWidget {
         const This = this.constructor;
 
         this._root.innerHTML += This._svg;
-        this.style.display = 'block';
  
         const d = SvgMath.describeArc(50, 50, 45, This._rangeStartAngle, This._rangeEndAngle);
         this._root.getElementById('range').setAttribute('d', d);
@@ -612,6 +761,11 @@ class Knob extends RangeInputWidget {
     }
     
     _redraw() {
+        if (this._canvas) {
+            this._redrawCanvas();
+            return;
+        }
+
         const body = this._root.getElementById('body'),
               value = this._root.getElementById('value'),
               pointer = this._root.getElementById('pointer');
@@ -630,6 +784,48 @@ class Knob extends RangeInputWidget {
                     : this._style('--pointer-on-color', window.getComputedStyle(value).stroke);
     }
 
+    _redrawCanvas() {
+        const ctx = CanvasRenderer.clear(this),
+              w = this._canvas.width,
+              h = this._canvas.height,
+              k = Math.min(w, h) / 100;
+
+        if (k == 0) {
+            return;
+        }
+
+        // Same geometry as the SVG version, viewBox="0 0 100 100" centered
+        ctx.translate((w - 100 * k) / 2, (h - 100 * k) / 2);
+        ctx.scale(k, k);
+
+        const This = this.constructor;
+        const range = Math.abs(This._rangeStartAngle) + Math.abs(This._rangeEndAngle);
+        const endAngle = This._rangeStartAngle + range * (this._value || 0);
+
+        ctx.lineWidth = 9;
+
+        ctx.strokeStyle = this._colors.range;
+        CanvasRenderer.arc(ctx, 50, 50, 45, This._rangeStartAngle, This._rangeEndAngle);
+        ctx.stroke();
+
+        if (endAngle > This._rangeStartAngle) {
+            ctx.strokeStyle = this._colors.value;
+            CanvasRenderer.arc(ctx, 50, 50, 45, This._rangeStartAngle, endAngle);
+            ctx.stroke();
+        }
+
+        ctx.fillStyle = this._colors.body;
+        ctx.beginPath();
+        ctx.arc(50, 50, 39, 0, 2 * Math.PI);
+        ctx.fill();
+
+        const p = SvgMath.polarToCartesian(50, 50, 28, endAngle);
+        ctx.fillStyle = this.value == 0 ? this._colors.pointerOff : this._colors.pointerOn;
+        ctx.beginPath();
+        ctx.arc(p.x, p.y, 3.5, 0, 2 * Math.PI);
+        ctx.fill();
+    }
+
     /**
      *  Private
      */
@@ -728,6 +924,23 @@ class Fader extends RangeInputWidget {
     connectedCallback() {
         super.connectedCallback();
 
+        if (CanvasRenderer.isEnabled(this)) {
+            this._graphic = this._style('--graphic', 'lines').toLowerCase();
+            this._rtl = this._style('direction', 'ltr') != 'ltr';
+            this._colors = {
+                body       : this._style('--body-color', '#404040'),
+                range      : this._style('--range-color', '#404040'),
+                value      : this._style('--value-color', '#ffffff'),
+                pointerOff : this._style('--pointer-off-color', '#000')
+            };
+            this._colors.pointerOn = this._style('--pointer-on-color', this._colors.value);
+            this._colors.pointerBorder = this._style('--pointer-border-color', this._colors.body);
+
+            this.style.display = 'block';
+            CanvasRenderer.attach(this);
+            return;
+        }
+
         this._root.innerHTML = `<style>
             #body { fill: ${this._style('--body-color', '#404040')}; }
             #range { stroke: ${this._style('--range-color', '#404040')}; }
@@ -753,6 +966,11 @@ class Fader extends RangeInputWidget {
     }
 
     _redraw() {
+        if (this._canvas) {
+            this._redrawCanvas();
+            return;
+        }
+
         const body = this._root.getElementById('body'),
               value = this._root.getElementById('value'),
               pointer = this._root.getElementById('pointer');
@@ -773,6 +991,57 @@ class Fader extends RangeInputWidget {
         }
     }
 
+    _redrawCanvas() {
+        const ctx = CanvasRenderer.clear(this),
+              w = this._canvas.width,
+              h = this._canvas.height,
+              k = window.devicePixelRatio || 1,
+              y = Math.round(h * (1.0 - (this._value || 0)));
+
+        switch (this._graphic) {
+            case 'lines': {
+                ctx.fillStyle = this._colors.body;
+                ctx.fillRect(0, 0, w, h);
+
+                // Equivalent to stroke-dasharray="7,1" starting at value
+                const dash = 7 * k, gap = 1 * k;
+                ctx.fillStyle = this._colors.value;
+
+                for (let yd = y; yd < h; yd += dash + gap) {
+                    ctx.fillRect(0, yd, w, Math.min(dash, h - yd));
+                }
+
+                break;
+            }
+            case 'split': {
+                const lineX = (this._rtl ? 0.95 : 0.05) * w,
+                      lineWidth = 0.07 * Math.sqrt((w * w + h * h) / 2),
+                      bodyX = this._rtl ? 0 : 0.2 * w,
+                      pointerX = (this._rtl ? 0.4 : 0.6) * w;
+
+                ctx.fillStyle = this._colors.range;
+                ctx.fillRect(lineX - lineWidth / 2, 0, lineWidth, h);
+                ctx.fillStyle = this._colors.value;
+                ctx.fillRect(lineX - lineWidth / 2, y, lineWidth, h - y);
+
+                ctx.fillStyle = this._colors.body;
+                ctx.fillRect(bodyX, 0, 0.8 * w, h);
+
+                ctx.fillStyle = this.value == 0 ? this._colors.pointerOff : this._colors.pointerOn;
+                ctx.strokeStyle = this._colors.pointerBorder;
+                ctx.lineWidth = k;
+                ctx.beginPath();
+                ctx.arc(pointerX, y, 3.5 * k, 0, 2 * Math.PI);
+                ctx.fill();
+                ctx.stroke();
+
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
     /**
      *  Private
      */
@@ -84,6 +84,14 @@ class ConsulUI extends DISTRHO.UI {
         }
     }
 
+    // Sets the MIDI map entry for a control, null restores the default. See
+    // README.md for the supported entry formats.
+    setMidiMapEntry(id, entry) {
+        const map = Object.assign({}, this._config['map']);
+        map[id] = entry !== null ? entry : this._buildDefaultMidiMap()[id];
+        this._setConfigEntry('map', map);
+    }
+
     onControl(...args) {
         const [id, value] = args;
         this._uiState[id] = value;
@@ -378,10 +386,24 @@ class ConsulUI extends DISTRHO.UI {
         const map = this._config['map'][el.id],
               desc = this._args.controlDescriptor.find(cd => cd.id == el.id[0]),
               midiVal = desc.cont ? v => Math.floor(127 * v)       : v => v ? 127 : 0,
-              strVal = desc.cont ? v => Math.round(100 * v) + '%' : v => v ? 'ON' : 'OFF',
-              status = (map[0] ^ 0xb0) == 0 /*cc*/? map[0] : (el.value ? /*on*/map[0] : /*off*/map[1]);
-
-        this.call('control', el.id, el.value, status, /*index*/map[2], midiVal(el.value));
+              strVal = desc.cont ? v => Math.round(100 * v) + '%' : v => v ? 'ON' : 'OFF';
+
+        if (Array.isArray(map)) {
+            const status = (map[0] ^ 0xb0) == 0 /*cc*/? map[0] : (el.value ? /*on*/map[0] : /*off*/map[1]);
+            this.call('control', el.id, el.value, status, /*index*/map[2], midiVal(el.value));
+        } else if (map && map.macro) {
+            // Macro entry { macro: [...] }, MIDI is generated by the plugin
+            // using the map compiled from config, see ControlMap.hpp
+            this.call('controlMacro', el.id, el.value);
+        } else if (map && Array.isArray(map.midi)) {
+            // Raw MIDI entry { midi: [...] } for SysEx and multiple messages,
+            // 'v' bytes are replaced with the 7-bit control value.
+            const bytes = map.midi.map(b => b === 'v' ? midiVal(el.value) : b);
+            this.call('controlMidi', el.id, el.value, bytes);
+        } else {
+            // Unmapped or unknown entry, only keep state and UIs in sync
+            this.call('controlMidi', el.id, el.value, []);
+        }
 
         if (this._shouldShowStatus) {
             // For some reason modifying the DOM here takes abnormally long on